@@ -103,5 +103,765 @@ DISCLAIMER:
   This link shows some of the costs (in flash space and execution time):
   http://www.nongnu.org/avr-libc/user-manual/benchmarks.html
   For ATtiny85 you have to refer to the Avr2 columns.
+
+* Measure where the time goes instead of guessing. simavr (https://github.com/buserror/simavr)
+  runs the unmodified .elf file and counts every cycle, so a few lines of host code give you
+  an exact (not sampled!) per-instruction profile:
+
+  avr_t *avr = avr_make_mcu_by_name( "attiny85" );
+  elf_firmware_t firmware;
+  elf_read_firmware( "game.elf", &firmware );
+  avr_init( avr );
+  avr_load_firmware( avr, &firmware );
+
+  static uint32_t cycles[8192 / 2];   // one counter per flash word
+  for ( uint32_t steps = 0; steps < 50000000; steps++ )
+  {
+    uint16_t pc = avr->pc;            // byte address!
+    avr_cycle_count_t start = avr->cycle;
+    int state = avr_run( avr );       // executes exactly one instruction
+    cycles[pc / 2] += avr->cycle - start;
+    if ( state == cpu_Done || state == cpu_Crashed ) { break; }
+  }
+
+  Dump all non-zero counters as "address count" and let 'avr-addr2line -f -e game.elf' turn
+  the addresses into function names and source lines. Summing per function and writing one
+  "function;file:line count" line per address gives a (flat) folded file which Brendan Gregg's
+  flamegraph.pl renders without complaints.
+  simavr advances the PC before the CPU goes to sleep, so cycles spent sleeping are counted at
+  the instruction after 'sleep' (check 'avr->state == cpu_Sleeping' to keep them separate).
+  Suddenly it's obvious how much time a frame spends waiting for I2C, in shift loops or
+  inside '__mulhi3'...
+
+* Find out which library routines actually made it into your binary. Most of the expensive
+  stuff (float emulation, division, sprintf(), malloc()) hides in libgcc or avr-libc routines
+  with telling names like '__mulhi3', '__divmodhi4', '__udivmodqi4', '__addsf3' or 'vfprintf':
+
+  avr-nm --size-sort -S game.elf | grep " __"
+
+  The ATtiny85 has no 'call' instruction, so every caller shows up as an 'rcall' in the listing:
+
+  avr-objdump -d game.elf | grep -E "rcall.*<__(mulhi3|divmodhi4|udivmodqi4|addsf3)>"
+
+  Adding '-Wl,-y,__divmodhi4' to the linker flags even names the object files referencing it.
+  Combined with the simavr profile from above you also know how often they were called and how
+  many cycles went into them - sometimes a single forgotten '/ 10' costs more than everything else.
+  While you are at it, an instruction mix histogram often tells the same story:
+
+  avr-objdump -d game.elf | awk -F'\t' 'NF > 2 { print $3 }' | sort | uniq -c | sort -rn
+
+* With only 512 bytes of SRAM, don't keep buffers alive that are never used at the same time.
+  Title screen, game and high score table usually exclude each other, so let them share the
+  same RAM by putting them into a union - this costs the maximum instead of the sum:
+
+  struct TitleScene { uint8_t scrollPos; char playerName[8]; };
+  struct GameScene  { uint8_t enemyX[8]; uint8_t enemyY[8]; uint16_t score; };
+  struct ScoreScene { uint16_t highScores[5]; char names[5][3]; };
+
+  union SceneRam
+  {
+    TitleScene title;
+    GameScene  game;
+    ScoreScene score;
+  } sceneRam;
+
+  When switching scenes, clear the whole union with a single 'memset( &sceneRam, 0, sizeof( sceneRam ) )'
+  (see above). For debugging it's worth having a global 'activeScene' byte and accessors like
+  'GameScene &game() { assert( activeScene == SCENE_GAME ); return sceneRam.game; }' inside an
+  '#ifdef DEBUG' - in the release build they simply return the union member.
+  'avr-nm -S -C --size-sort game.elf' lists the size of 'sceneRam' and every other global, and
+  a 'static_assert( sizeof( GameScene ) <= 200, "game scene too large" );' per scene
+  keeps an eye on the peak RAM of each scene (don't forget to leave room for the stack!).
+
+* Even without a bootloader the ATtiny85 can write its own flash using 'SPM' - useful for
+  larger read-mostly data like level progress or recorded demos that don't fit into the 512 bytes
+  of EEPROM. The SELFPRGEN fuse (bit 0 of the extended fuse byte) must be programmed, otherwise
+  'SPM' does nothing. Reserve whole 64 byte pages, so you won't erase your own code:
+
+  #include <avr/boot.h>
+
+  const uint8_t storage[SPM_PAGESIZE] __attribute__ ( ( aligned( SPM_PAGESIZE ) ) ) PROGMEM = { 0xFF };
+
+  void writeStoragePage( const uint8_t *data )
+  {
+    uint16_t address = (uint16_t)storage;
+    uint8_t sreg = SREG;
+    cli();
+    eeprom_busy_wait();                  // a running EEPROM write blocks SPM
+    boot_page_erase( address );
+    boot_spm_busy_wait();
+    for ( uint8_t n = 0; n < SPM_PAGESIZE; n += 2 )
+    {
+      boot_page_fill( address + n, data[n] | ( data[n + 1] << 8 ) );
+    }
+    boot_page_write( address );
+    boot_spm_busy_wait();
+    SREG = sreg;
+  }
+
+  The CPU halts for about 4.5 ms per erase and per write and the flash survives only about
+  10,000 erase cycles, so collect your changes in RAM and write a page once, not byte by byte.
+  Afterwards compare the page with 'pgm_read_byte()' against your data to verify it.
+  Make sure the brown-out detection is enabled, a power loss during 'SPM' leaves an erased page.
+
+* You don't have to run at full speed all the time. The system clock prescaler can be changed
+  at runtime, e.g. full speed while rendering a frame and 1/8 while waiting for the next one:
+
+  #include <avr/power.h>
+
+  clock_prescale_set( clock_div_8 );   // handles the timed CLKPCE sequence for you
+  ...
+  clock_prescale_set( clock_div_1 );
+
+  Keep in mind that everything derived from F_CPU ('delay()', '_delay_us()', 'millis()', baud rates
+  and bit-banged I2C timing) is now off by the prescaler factor. Either switch back to full speed
+  before talking to the display, or let your timer ISR add a 'tickIncrement' which you set
+  whenever you change the prescaler (and not '1 << prescaler' inside the ISR ;)
+  The PLL clock (16 MHz) can't be selected at runtime, it requires the CKSEL fuses = 0001.
+  The internal RC oscillator can be pushed a bit further by increasing OSCCAL, but don't write
+  to the EEPROM or flash when running above 8.8 MHz and check the timing on a scope (or in
+  simavr, by counting the cycles of a frame) for every chip.
+
+* Without a framebuffer (the TinyJoypad's SSD1306 is fed page by page, 8 rows per byte) every
+  primitive has to answer "which bits of this column byte are set?". Never build the mask with
+  'y & 7' and variable shifts, use two small tables instead:
+
+  const uint8_t maskFromRow[8] PROGMEM = { 0xFF, 0xFE, 0xFC, 0xF8, 0xF0, 0xE0, 0xC0, 0x80 };
+  const uint8_t maskToRow[8]   PROGMEM = { 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF };
+
+  // bits for rows yTop..yBottom of the current page (both 0..7)
+  uint8_t spanMask( uint8_t yTop, uint8_t yBottom )
+  {
+    return pgm_read_byte( &maskFromRow[yTop] ) & pgm_read_byte( &maskToRow[yBottom] );
+  }
+
+  Filled rectangles and vertical lines are then just one 'spanMask()' per column and page.
+  Don't restart Bresenham for lines on every page - that calculates each line 8 times. Instead
+  draw each line from top to bottom (swap the end points if necessary) and when it leaves the
+  current page, save its state (x, y and error) and resume from there on the next page, so
+  every pixel is calculated exactly once. Circles only touch the pages from ( cy - r ) >> 3 to
+  ( cy + r ) >> 3, so skip the others completely and clip the 8 mirrored points of the midpoint
+  algorithm to the y range of the current page.
+  Two 'lpm' table reads and an 'and' are roughly 15 cycles per column byte, so even a full width
+  rectangle costs only ~2,000 cycles per page or ~16,000 cycles per frame (128 x 64 pixels).
+
+* Text eats flash quickly. First of all, identical 'PSTR()' strings are NOT merged by the compiler,
+  so every "GAME OVER" costs its full length again - put each text into one named PROGMEM array.
+  If words repeat a lot, a tiny dictionary helps: use character codes >= 0x80 as a reference
+  to a common word and let the text output expand them on the fly:
+
+  const char word0[] PROGMEM = "PRESS ";
+  const char word1[] PROGMEM = "LEVEL ";
+  const char * const dictionary[] PROGMEM = { word0, word1 };
+  const char textStart[] PROGMEM = "\x80" "FIRE";             // "PRESS FIRE"
+
+  void printText( const char *text )
+  {
+    uint8_t c;
+    while ( ( c = pgm_read_byte( text++ ) ) != 0 )
+    {
+      if ( c & 0x80 )
+      {
+        printText( (const char *)pgm_read_word( &dictionary[c & 0x7F] ) );
+      }
+      else
+      {
+        printChar( c );   // straight into the font renderer, no RAM buffer required
+      }
+    }
+  }
+
+  Choosing the words is best left to a small script on the PC which collects all strings,
+  counts the savings for each candidate and prints the encoded arrays plus the number of bytes
+  saved against the raw strings. Huffman coding squeezes out a bit more, but the decoder
+  (and its tree) easily eats up the gain on a few hundred bytes of text - measure it!
+
+* Instead of floats use 8.8 fixed point for positions and velocities: the high byte is the
+  pixel, the low byte the fraction. Reading the pixel with '>> 8' costs nothing, gcc just
+  takes the high byte. Gravity, bounce and friction then only need additions and constant shifts:
+
+  #define PARTICLES 16
+  #define GRAVITY   16                  // 1/16 pixel per frame^2
+  #define FLOOR     ( 63 << 8 )
+
+  int16_t particleY[PARTICLES];
+  int16_t velocityY[PARTICLES];
+
+  for ( uint8_t n = 0; n < PARTICLES; n++ )
+  {
+    velocityY[n] += GRAVITY;
+    particleY[n] += velocityY[n];
+    if ( particleY[n] > FLOOR )
+    {
+      particleY[n] = FLOOR;
+      velocityY[n] = -velocityY[n] + ( velocityY[n] >> 2 );  // bounce with 75% of the speed (~56% energy)
+    }
+  }
+
+  Horizontal friction works the same way: 'velocityX[n] -= velocityX[n] >> 4;'.
+  Whether separate arrays per attribute (as above) or an array of structs is better depends:
+  gcc can access a struct through one pointer with displacement ('ldd'), while separate arrays
+  need an address calculation for each - but are nicer if a loop only touches one attribute.
+  Try both and count the cycles. At 8 MHz and 30 frames per second you have ~266,000 cycles per
+  frame, so simavr tells you quickly how many particles you can afford (twice as many at 16 MHz).
+
+* Don't use 'qsort()' for a handful of values - it calls your compare function through a pointer
+  for every comparison and drags in library code. For small fixed sizes a sorting network
+  is both smaller and faster, e.g. for 4 values (5 compare-exchanges, no loops):
+
+  static inline void sort2( uint8_t &a, uint8_t &b )
+  {
+    if ( a > b ) { uint8_t t = a; a = b; b = t; }
+  }
+
+  void sort4( uint8_t *v )
+  {
+    sort2( v[0], v[1] ); sort2( v[2], v[3] );
+    sort2( v[0], v[2] ); sort2( v[1], v[3] );
+    sort2( v[1], v[2] );
+  }
+
+  Filtering noisy ADC button readings only needs the median of 3, which is just three compares:
+
+  uint8_t median3( uint8_t a, uint8_t b, uint8_t c )
+  {
+    if ( a > b ) { uint8_t t = a; a = b; b = t; }
+    if ( b > c ) { b = c; }
+    return ( a > b ) ? a : b;
+  }
+
+  A high score table is already sorted, so inserting a new score is a single insertion sort
+  pass from the end. Keep the values 8 bit wherever possible, 16 bit compares double the code.
+
+* Looking up a value for a key (button code, note name, command byte) is usually done with a
+  linear search and a 'break' - which is expensive, see above. If the keys are sorted and the
+  table is padded to a power of two (here 16 entries), a binary search needs exactly four
+  iterations and no 'break' at all:
+
+  const uint8_t keys[16]   PROGMEM = { ... };   // sorted, unused entries padded with 0xFF
+  const uint8_t values[16] PROGMEM = { ... };
+
+  uint8_t lookup( uint8_t key )
+  {
+    uint8_t index = 0;
+    for ( uint8_t step = 8; step != 0; step >>= 1 )
+    {
+      if ( pgm_read_byte( &keys[index + step - 1] ) < key ) { index += step; }
+    }
+    return pgm_read_byte( &values[index] );
+  }
+
+  For very few keys the linear search is still smaller, so compare both.
+  Sometimes you can even skip the search completely: a little brute force script on the PC
+  often finds a cheap formula like '( key ^ ( key >> 3 ) ) & 0x07' that maps each key to a
+  different index (a minimal perfect hash), and the lookup becomes a single table access.
+
+* Bit tricks without '1 << n': mirroring a sprite needs to reverse the bits of every byte.
+  gcc compiles '( b >> 4 ) | ( b << 4 )' for an uint8_t into a single 'swap', so this
+  shift-and-mask version has no loop at all:
+
+  b = ( b >> 4 ) | ( b << 4 );
+  b = ( ( b & 0xCC ) >> 2 ) | ( ( b & 0x33 ) << 2 );
+  b = ( ( b & 0xAA ) >> 1 ) | ( ( b & 0x55 ) << 1 );
+
+  A 16 byte PROGMEM table with the reversed nibbles is another option, or if flash is really
+  tight, this loop (10 bytes, 40 cycles):
+
+  uint8_t reverseBits( uint8_t in )
+  {
+    uint8_t out, count;
+    asm( "ldi %2, 8 \n"
+         "1: lsl %1 \n"     // highest bit of 'in' into carry...
+         "ror %0 \n"        // ...and from carry into 'out'
+         "dec %2 \n"
+         "brne 1b \n"
+         : "=&r" ( out ), "+r" ( in ), "=&d" ( count ) );
+    return out;
+  }
+
+  For counting set bits, '__builtin_popcount()' calls a libgcc routine, whereas
+  'for ( ; b != 0; b &= b - 1 ) { count++; }' only loops once per set bit.
+  The parity is three shifts and XORs (the first one is a 'swap' again): 'b ^= b >> 4;
+  b ^= b >> 2; b ^= b >> 1;' leaves it in bit 0. Counting leading zeros (or finding the highest
+  set bit) works with a nibble table and one compare:
+
+  const uint8_t leadingZeros[16] PROGMEM = { 4, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+  uint8_t clz8( uint8_t b )       // returns 8 for b = 0
+  {
+    return ( b & 0xF0 ) ? pgm_read_byte( &leadingZeros[b >> 4] )
+                        : 4 + pgm_read_byte( &leadingZeros[b] );
+  }
+
+  If you need the lowest set bit as a mask rather than its number, 'b & -b' does it without a loop.
+  With only 256 possible inputs, test every variant on the PC against a naive loop.
+
+* Often 16 bits are too few but 32 bits are too many. avr-gcc knows the types '__uint24' and
+  '__int24', which need one register (and one instruction per operation) less than uint32_t:
+
+  typedef __uint24 uint24_t;
+
+  uint24_t frameTime;      // milliseconds, overflows after ~4.6 hours instead of ~49 days
+  uint24_t positionX;      // 16.8 fixed point - 16 bit pixel range plus 8 bit fraction
+
+  Conversions work as expected ('(uint16_t)( positionX >> 8 )' is just a register move), but
+  be careful when mixing with uint32_t or when printing - cast explicitly to avoid surprises.
+  Each load or store of a 24 bit global saves an 'lds'/'sts' (4 bytes, 2 cycles) and each
+  addition, subtraction or compare one instruction against uint32_t - in a timer ISR which
+  increments and compares a counter that quickly adds up to a dozen bytes.
+
+* Clamping values is a typical victim of integer promotion: 'if ( a + b > 255 )' is calculated
+  in 16 bit. Saturating add and subtract fit into three instructions each when using the carry:
+
+  uint8_t satAdd8( uint8_t a, uint8_t b )
+  {
+    uint8_t carry;
+    asm( "add %0, %2 \n"
+         "sbc %1, %1 \n"    // 0xFF on overflow, else 0x00
+         "or  %0, %1 \n"
+         : "+r" ( a ), "=&r" ( carry ) : "r" ( b ) );
+    return a;
+  }
+
+  uint8_t satSub8( uint8_t a, uint8_t b )
+  {
+    asm( "sub %0, %1 \n"
+         "brcc 1f \n"
+         "clr %0 \n"        // 0x00 on underflow
+         "1: \n"
+         : "+r" ( a ) : "r" ( b ) );
+    return a;
+  }
+
+  To clamp a 16 bit value to 0..255 only test the high byte once:
+  'if ( value >> 8 ) { value = ( value < 0 ) ? 0 : 255; }'.
+  Be careful with FastLED style 'scale8()' ( ( a * b ) >> 8 ): the ATtiny85 has no 'mul'
+  instruction, so the C version calls '__mulhi3'. This shift-and-add loop stays in 8 bit and
+  returns exactly ( value * scale ) >> 8:
+
+  uint8_t scale8( uint8_t value, uint8_t scale )
+  {
+    uint8_t result, count;
+    asm( "clr %0 \n"
+         "ldi %2, 8 \n"
+         "1: lsr %1 \n"     // next bit of 'scale' into carry
+         "brcc 2f \n"
+         "add %0, %3 \n"    // carry now holds the overflow of the addition
+         "2: ror %0 \n"
+         "dec %2 \n"
+         "brne 1b \n"
+         : "=&r" ( result ), "+r" ( scale ), "=&d" ( count ) : "r" ( value ) );
+    return result;
+  }
+
+  A 'lerp8()' is then just a compare and a 'scale8()':
+
+  uint8_t lerp8( uint8_t a, uint8_t b, uint8_t fraction )
+  {
+    return ( b >= a ) ? a + scale8( b - a, fraction ) : a - scale8( a - b, fraction );
+  }
+
+  That's 6 bytes and 3 cycles for each saturating operation and 16 bytes and 57 cycles for
+  'scale8()' - without pulling '__mulhi3' out of the library.
+
+* Music doesn't need 'tone()'. PB4 (configured as output above) is OC1B, so Timer1 can toggle the
+  buzzer in hardware and the CPU only has to start the next note from time to time.
+  A whole event fits into one byte - 3 bits duration, 5 bits note (0 = pause):
+
+  #define SONG_END 0xFF                                              // reserved, not a note
+  const uint8_t song[] PROGMEM = { 0x2C, 0x2E, 0x50, ..., SONG_END };  // converted on the PC
+  const uint8_t noteTop[32] PROGMEM = { ... };                      // OCR1C per note
+  const uint8_t notePrescaler[32] PROGMEM = { ... };                // CS13..CS10 per note
+  const uint8_t durationFrames[8] PROGMEM = { 2, 3, 4, 6, 8, 12, 16, 32 };
+  uint8_t eventFrames;
+  const uint8_t *songPtr;
+
+  void playEvent( uint8_t event )
+  {
+    uint8_t note = event & 0x1F;
+    OCR1C = OCR1B = pgm_read_byte( &noteTop[note] );
+    TCCR1 = ( 1 << CTC1 ) | pgm_read_byte( &notePrescaler[note] );   // prescaler 0 stops the timer
+    GTCCR = note ? ( 1 << COM1B0 ) : 0;                               // toggle OC1B on compare match
+    eventFrames = pgm_read_byte( &durationFrames[event >> 5] );
+  }
+
+  void playNextEvent()
+  {
+    uint8_t event = pgm_read_byte( songPtr++ );
+    if ( event == SONG_END )                    // start over instead of playing whatever follows
+    {
+      songPtr = song;
+      event = pgm_read_byte( songPtr++ );
+    }
+    playEvent( event );
+  }
+
+  The frequency is F_CPU / ( 2 * prescaler * ( OCR1C + 1 ) ), so let the converter script (which
+  also turns RTTTL strings into the event bytes) calculate both tables.
+  Start a song with 'songPtr = song; playNextEvent();' (otherwise the first decrement wraps
+  'eventFrames' to 255). Per frame the only work is then
+  'if ( --eventFrames == 0 ) { playNextEvent(); }'. To play a song only once, set 'TCCR1 = 0'
+  at SONG_END instead of starting over and stop calling 'playNextEvent()'.
+  The code is just a few dozen instructions plus 72 bytes of tables, so the player should stay
+  below 300 bytes of flash - check with 'avr-size' before and after adding it.
+
+* To compare optimizations on identical gameplay, record the buttons once and replay them.
+  The button state rarely changes between frames, so store (buttons, frames) pairs in the EEPROM:
+
+  uint8_t lastButtons;
+  uint8_t runLength;
+  uint8_t *eepromPos;
+
+  void recordFrame( uint8_t buttons )
+  {
+    if ( buttons != lastButtons || runLength == 255 )
+    {
+      if ( runLength != 0 && eepromPos < (uint8_t *)E2END )   // no empty run on the first frame
+      {
+        eeprom_update_byte( eepromPos++, lastButtons );
+        eeprom_update_byte( eepromPos++, runLength );
+      }
+      lastButtons = buttons;
+      runLength = 0;
+    }
+    runLength++;
+  }
+
+  (Remember to write the final pair at the end of the recording.) In replay mode the input
+  routine reads the pairs back instead of the pins. Everything else has to be deterministic,
+  too: seed 'random()' with a constant and count time in frames, not in 'millis()'.
+  Read the EEPROM back with avrdude and link it as initialized 'EEMEM' data - simavr loads the
+  .eeprom section of the elf file, so the emulator replays the very same game.
+
+* Passing data from an ISR to 'loop()' doesn't require 'cli()'/'sei()' around every access.
+  On AVR reading or writing a single byte is atomic, so a ring buffer with 8 bit indices, one
+  producer and one consumer is safe as long as each index is only written by one side:
+
+  template <uint8_t SIZE> class RingBuffer
+  {
+    static_assert( ( SIZE & ( SIZE - 1 ) ) == 0 && SIZE <= 128, "SIZE must be a power of two <= 128" );
+    uint8_t data[SIZE];
+    volatile uint8_t head;    // only written by the producer
+    volatile uint8_t tail;    // only written by the consumer
+  public:
+    bool push( uint8_t value )
+    {
+      uint8_t h = head;
+      if ( (uint8_t)( h - tail ) == SIZE ) { return false; }   // full
+      data[h & ( SIZE - 1 )] = value;
+      asm volatile( "" ::: "memory" );   // store data before publishing it
+      head = h + 1;
+      return true;
+    }
+    bool pop( uint8_t &value )
+    {
+      uint8_t t = tail;
+      if ( head == t ) { return false; }                        // empty
+      asm volatile( "" ::: "memory" );   // don't read data before checking head
+      value = data[t & ( SIZE - 1 )];
+      asm volatile( "" ::: "memory" );   // read data before releasing the slot
+      tail = t + 1;
+      return true;
+    }
+  };
+
+  The empty 'asm' statements are important: without them gcc may move the (non volatile)
+  access to 'data' behind the index update, or even read 'data' before checking 'head'.
+  The indices run freely and are only masked on access, so all SIZE slots can be used.
+  If you don't need the general purpose I/O registers GPIOR0/GPIOR1 for anything else, use
+  them as head and tail - they are accessed with single cycle 'in'/'out' instead of 'lds'/'sts'.
+
+* Reading a 16 or 24 bit variable which is updated by an ISR is not atomic, an interrupt may
+  strike between the bytes. Instead of 'ATOMIC_BLOCK' (which delays e.g. a sound ISR) simply
+  read it twice until both reads agree:
+
+  volatile uint16_t ticks;   // incremented by a timer ISR
+
+  uint16_t readTicks()
+  {
+    uint16_t value;
+    do { value = ticks; } while ( value != ticks );
+    return value;
+  }
+
+  For whole structures let the ISR increment a volatile 8 bit sequence counter after each update
+  and copy the structure in 'loop()' until the counter is the same before and after the copy.
+  Since the main loop can't interrupt the ISR, this never blocks interrupts.
+  To make sure it really works, single step the reader in simavr and trigger the interrupt
+  after every single instruction once - bugs like these hardly ever show up in normal tests.
+
+* Polling buttons each frame may miss short presses and costs time even when nothing happens.
+  A pin change interrupt can timestamp each edge into the ring buffer from above and the game
+  debounces lazily when it reads the events (ignore edges of the same pin within a few ms):
+
+  RingBuffer<8> buttonEvents;
+
+  ISR( PCINT0_vect )
+  {
+    // one byte per event: timestamp from a free running timer with the pin state in bit 1
+    buttonEvents.push( ( TCNT0 & ~( 1 << PB1 ) ) | ( PINB & ( 1 << PB1 ) ) );
+  }
+
+  // enable the pin change interrupt for D1 (PB1)
+  PCMSK = ( 1 << PCINT1 );
+  GIMSK |= ( 1 << PCIE );
+  // Timer0 at prescaler 1024: 128 us per tick at 8 MHz, wraps every 32.8 ms
+  TCCR0B = ( 1 << CS02 ) | ( 1 << CS00 );
+
+  With the core's default prescaler of 64 'TCNT0' wraps every 2 ms, too fast for a debounce
+  window - so this needs 'millis()' disabled (as suggested above) or another timer at /1024.
+  A 5 ms window is then '(uint8_t)( now - lastEdge ) < 40'. The pin state replaces bit 1 of
+  the timestamp because it already sits in bit 1 of PINB - so packing needs no shift at all,
+  and losing 128 us of resolution doesn't matter for buttons.
+  Note that this only works for digital inputs - the TinyJoypad reads the directions as analog
+  voltages on A0 and A3, so only the fire button on D1 can be handled this way.
+  Each edge costs roughly 60 cycles (mostly the ISR's register saving), while polling a digital
+  pin is just a few cycles per frame - so the gain is catching short presses and exact
+  timestamps, not saving CPU time.
+
+* Need more PWM outputs than the hardware offers? Bit angle modulation needs just 8 interrupts
+  per period for 8 bit brightness on all pins: bit n of each brightness is output for 2^n timer
+  ticks. Precompute the PORTB value for each bit (only when a brightness changes) and the ISR
+  is reduced to a table access - the doubling interval is just another shift by one:
+
+  #define PWM_PINS ( ( 1 << PB0 ) | ( 1 << PB1 ) | ( 1 << PB2 ) | ( 1 << PB3 ) | ( 1 << PB4 ) )
+  volatile uint8_t bitPlane[8];
+
+  ISR( TIMER0_COMPA_vect )
+  {
+    static uint8_t plane;
+    static uint8_t top;
+    PORTB = ( PORTB & ~PWM_PINS ) | bitPlane[plane];
+    OCR0A = top;                              // CTC mode: this plane lasts top + 1 ticks
+    plane = ( plane + 1 ) & 0x07;
+    top = plane ? ( top << 1 ) | 1 : 0;
+  }
+
+  Filling 'bitPlane[]' uses the loop from above: 'for ( uint8_t bit = 1; bit != 0; bit <<= 1 )'.
+  If you disabled 'millis()' as suggested, Timer0 is free for this. Make sure the shortest
+  plane is still longer than the ISR: with prescaler 64 (8 us = 64 cycles per tick at 8 MHz)
+  a period takes 255 ticks (~490 Hz), and an ISR of about 50 cycles 8 times per period costs
+  only ~2.5% of the CPU.
+
+* With the 5 I/O pins PB0..PB4 you can charlieplex 5 * 4 = 20 LEDs. Every LED is defined by
+  the two pins that are outputs (DDRB) and the one which is high (PORTB), so precompute both
+  in PROGMEM - the shifts are evaluated by the compiler:
+
+  #define LED( high, low ) { ( 1 << high ) | ( 1 << low ), ( 1 << high ) }
+  const uint8_t ledPins[20][2] PROGMEM = {
+    LED( PB0, PB1 ), LED( PB1, PB0 ), LED( PB0, PB2 ), LED( PB2, PB0 ), LED( PB0, PB3 ),
+    LED( PB3, PB0 ), LED( PB0, PB4 ), LED( PB4, PB0 ), LED( PB1, PB2 ), LED( PB2, PB1 ),
+    LED( PB1, PB3 ), LED( PB3, PB1 ), LED( PB1, PB4 ), LED( PB4, PB1 ), LED( PB2, PB3 ),
+    LED( PB3, PB2 ), LED( PB2, PB4 ), LED( PB4, PB2 ), LED( PB3, PB4 ), LED( PB4, PB3 ) };
+  volatile uint8_t brightness[20];   // 4 bit
+
+  ISR( TIMER0_COMPA_vect )
+  {
+    static uint8_t led;
+    static uint8_t bit = 0x01;
+    DDRB = 0;                                  // all LEDs off first to avoid ghosting
+    if ( brightness[led] & bit )
+    {
+      PORTB = pgm_read_byte( &ledPins[led][1] );
+      DDRB  = pgm_read_byte( &ledPins[led][0] );
+    }
+    OCR0A = ( bit << 4 ) - 1;                  // 16, 32, 64, 128 ticks (bit angle modulation)
+    bit <<= 1;
+    if ( bit == 0x10 ) { bit = 0x01; if ( ++led == 20 ) { led = 0; } }
+  }
+
+  With prescaler 8 at 8 MHz (1 us per tick) each LED takes 240 us, so all 20 LEDs are refreshed
+  every 4.8 ms (~208 Hz) using 80 interrupts. At roughly 60 cycles per ISR that's about 12%
+  of the CPU. Each LED is lit at most 1/20 of the time, so choose the resistors accordingly.
+
+* 'Servo.h' is way too big, but 5 servos can be driven from a single compare channel:
+  start all pulses at the same time, then end them one after another in sorted order.
+  With Timer1 at prescaler 64 (8 us per tick at 8 MHz) a 1..2 ms pulse is 125..250 ticks, so
+  the 8 bit counter never overflows during the pulses:
+
+  TCCR1 = ( 1 << CS12 ) | ( 1 << CS11 ) | ( 1 << CS10 );   // prescaler 64
+  TIMSK |= ( 1 << OCIE1A );
+
+  uint8_t servoTime[5];        // sorted pulse end times in ticks (insertion sort, see above)
+  uint8_t servoMask[5];        // PORTB bits to clear at this time
+  uint8_t servoEvent;
+
+  void startServoFrame()       // call every 20 ms
+  {
+    TCNT1 = 0;                 // restart the counter first, so the old OCR1A can't match...
+    OCR1A = servoTime[0];
+    TIFR = ( 1 << OCF1A );     // ...and drop a match from the last wrap that is still pending
+    servoEvent = 0;
+    PORTB |= SERVO_PINS;
+  }
+
+  ISR( TIMER1_COMPA_vect )
+  {
+    while ( servoEvent < 5 )
+    {
+      uint8_t time = servoTime[servoEvent];
+      OCR1A = time;                        // set the next compare match first...
+      if ( time > TCNT1 ) { return; }      // ...so it can't be missed if it's still ahead
+      PORTB &= ~servoMask[servoEvent++];   // otherwise it's due (or overdue) - end it right now
+    }
+  }
+
+  For smooth moves keep the positions in 8.8 fixed point and move them towards the target
+  every frame: 'position += ( target - position ) >> 3;'.
+  Other interrupts delay the falling edges and show up as jitter: a 60 cycle ISR (like the one
+  behind 'millis()') delays a pulse end by up to 7.5 us at 8 MHz - about one timer tick, which
+  is less than a servo can resolve.
+
+* Stepper acceleration doesn't need a division per step if the ISR runs at a fixed rate and
+  accumulates the speed in a 16 bit phase accumulator - a step is due whenever it overflows.
+  Accelerating is then just an addition per interrupt, and because the ramps are symmetric
+  the deceleration starts when the remaining steps equal the steps needed to speed up:
+
+  volatile uint16_t speed;     // fractional steps per interrupt, MIN_SPEED..MAX_SPEED
+  volatile uint16_t phase;
+  volatile uint16_t stepsLeft;
+  volatile uint16_t rampSteps;
+
+  void startMove( uint16_t steps )   // only while the motor stands still
+  {
+    speed = MIN_SPEED;
+    phase = 0;
+    rampSteps = 0;
+    ATOMIC_BLOCK( ATOMIC_RESTORESTATE ) { stepsLeft = steps; }   // 16 bit write comes last
+  }
+
+  ISR( TIMER0_COMPA_vect )
+  {
+    PORTB &= ~( 1 << STEP_PIN );             // end the previous step pulse
+    uint16_t steps = stepsLeft;              // local copies, so the volatiles are read only once
+    if ( steps == 0 ) { return; }
+    uint16_t v = speed;
+    uint16_t ramp = rampSteps;
+    uint16_t p = phase + v;
+    phase = p;
+    if ( p < v )                             // overflow -> step
+    {
+      PORTB |= ( 1 << STEP_PIN );
+      steps--;
+      if ( steps > ramp && v < MAX_SPEED ) { ramp++; }   // count while accelerating only
+    }
+    if ( steps <= ramp ) { v = ( v > MIN_SPEED + ACCELERATION ) ? v - ACCELERATION : MIN_SPEED; }
+    else { v = ( v < MAX_SPEED - ACCELERATION ) ? v + ACCELERATION : MAX_SPEED; }
+    speed = v;
+    stepsLeft = steps;
+    rampSteps = ramp;
+  }
+
+  MIN_SPEED must be greater than 0, otherwise the motor stops with steps left. The clamping
+  keeps 'speed' between MIN_SPEED and MAX_SPEED, so it can't wrap around at either end.
+
+  The maximum step rate is the interrupt rate, which is limited by the ISR duration: e.g. a
+  20 kHz interrupt on a 60 cycle ISR already eats 15% of the CPU at 8 MHz (7.5% at 16 MHz).
+
+* Need more than 10 bits from the ADC? Sum up 4^n samples and shift the sum right by n to get
+  n additional bits - 16 samples give 12 bits and still fit into an uint16_t. Converting in the
+  ADC noise reduction sleep mode stops the CPU clock during the conversion:
+
+  EMPTY_INTERRUPT( ADC_vect );
+
+  uint16_t readAdc()
+  {
+    set_sleep_mode( SLEEP_MODE_ADC );
+    ADCSRA |= ( 1 << ADIE );
+    do { sleep_mode(); } while ( ADCSRA & ( 1 << ADSC ) );   // other interrupts wake us, too
+    return ADC;
+  }
+
+  uint16_t readAdc12Bit()
+  {
+    uint16_t sum = 0;
+    for ( uint8_t n = 16; n != 0; n-- ) { sum += readAdc(); }
+    return sum >> 2;
+  }
+
+  Oversampling only works if there is at least 1 LSB of noise on the signal - with a very
+  clean signal all samples are equal and you gain nothing.
+  The internal temperature sensor is 'ADMUX = ( 1 << REFS1 ) | 0x0F;' (1.1 V reference), and the
+  supply voltage can be measured against the bandgap with 'ADMUX = 0x0C;' as
+  VCC = 1.1 V * 1024 / ADC (calculate that once, it's a 32 bit division).
+  After switching ADMUX to one of these channels the reference needs about 1 ms to settle,
+  so wait (or throw away the first samples) before starting the oversampling loop - otherwise
+  the first results are simply wrong.
+  With an ADC clock of 125 kHz (prescaler 64 at 8 MHz) a conversion takes 13 ADC cycles,
+  that's ~9600 samples or ~600 12 bit results per second. And no 'analogRead()' required ;)
+
+* Decoding an NEC infrared remote only needs a pin change interrupt and a free running timer.
+  Measuring from falling edge to falling edge, a '0' takes 1.125 ms, a '1' 2.25 ms and the
+  leader 13.5 ms. With Timer0 at prescaler 1024 (128 us per tick at 8 MHz) these are about
+  9, 18 and 105 ticks - all fit into 8 bits, so no 16 or 32 bit math in the ISR:
+
+  volatile uint8_t irData[4];
+  volatile uint8_t irBitCount = 0xFF;        // 0xFF = waiting for leader, 32 = frame received
+
+  ISR( PCINT0_vect )
+  {
+    static uint8_t lastEdge;
+    if ( PINB & ( 1 << IR_PIN ) ) { return; }  // only falling edges
+    uint8_t now = TCNT0;
+    uint8_t delta = now - lastEdge;
+    lastEdge = now;
+    if ( delta > 95 && delta < 120 ) { irBitCount = 0; }
+    else if ( irBitCount < 32 )
+    {
+      volatile uint8_t *data = &irData[irBitCount >> 3];
+      *data >>= 1;                             // NEC sends LSB first
+      if ( delta > 13 ) { *data |= 0x80; }
+      irBitCount = ( delta > 5 && delta < 26 ) ? irBitCount + 1 : 0xFF;
+    }
+  }
+
+  The main loop checks 'irBitCount == 32', verifies that byte 1 and 3 are the inverse of
+  byte 0 and 2 and resets 'irBitCount' to 0xFF.
+  The ISR only reads TCNT0, so the timer's overflow interrupt can still drive a coarse clock
+  (32.8 ms per overflow). RC5 works the same way: it's Manchester coded with 889 us half bits
+  (~7 ticks), so decide by 1 or 2 half bits between edges of both polarities.
+  A NEC frame has 34 falling and 34 rising edges (those return right away), so at roughly 50
+  resp. 30 cycles per edge decoding costs ~3,000 cycles spread over 67.5 ms, and the received
+  code is ready right at the last edge.
+
+* Using the ATtiny85 as an I2C slave (SDA = PB0, SCL = PB2) works fine with the USI - start
+  with Atmel's application note AVR312 instead of a library. The USI stretches the clock
+  (holds SCL low) until the counter overflow flag is cleared, so every cycle in the overflow
+  ISR before writing USISR slows down the whole bus. Prepare the next byte in advance and
+  release the bus first:
+
+  volatile uint8_t registers[16];  // the register map, shared between the ISR and 'loop()'
+  uint8_t registerPointer;         // set by the first byte of a write, auto-incremented
+  uint8_t nextByte;                // registers[registerPointer & 0x0F] when the last byte was
+                                   // handled - 'loop()' may change that register in the meantime
+  bool expectPointer;              // set when our address was received with the write bit
+
+  // inside the overflow ISR, master reads data:
+  USIDR = nextByte;                                           // prepared during the last byte
+  USISR = ( 1 << USIOIF ) | ( 1 << USIPF ) | ( 1 << USIDC );  // release SCL as early as possible
+  nextByte = registers[++registerPointer & 0x0F];
+
+  // inside the overflow ISR, master wrote data:
+  uint8_t data = USIDR;          // save it first - the ACK is shifted out through USIDR
+  USIDR = 0;                     // ACK (as in AVR312)
+  DDRB |= ( 1 << PB0 );
+  USISR = ( 1 << USIOIF ) | ( 1 << USIPF ) | ( 1 << USIDC ) | 0x0E;   // release SCL for one bit
+  if ( expectPointer )
+  {
+    registerPointer = data;      // the first byte selects the register
+    expectPointer = false;
+  }
+  else
+  {
+    registers[registerPointer++ & 0x0F] = data;
+  }
+  nextByte = registers[registerPointer & 0x0F];               // for a following (repeated start) read
+
+  If 'loop()' changes a register while the master might be reading it, it should refresh
+  'nextByte' with interrupts disabled, or the master gets the old value once.
+  Masking the pointer with '& 0x0F' makes the burst wrap around the register map without a compare.
+  Find the maximum bus clock by sweeping the master's clock while watching for NACKs and
+  stretched clocks on a logic analyzer - as far as I know simavr doesn't emulate the USI
+  two wire mode well enough for this.
   
 */